@@ -0,0 +1,605 @@
+// MRFetchedResultsControllerTraceTest.m
+//
+// Copyright (c) 2015 Héctor Marqués
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <XCTest/XCTest.h>
+#import <CoreData/CoreData.h>
+
+#import "MRFetchedResultsController.h"
+#import "MRFetchedResultsControllerTrace.h"
+
+
+#pragma mark - _MRFetchedResultsControllerTraceDelegate -
+
+
+/**
+ Mock up of a `MRFetchedResultsControllerDelegate` that only implements `controller:didChangeObject:atIndexPath:forChangeType:newIndexPath:` and `controllerDidChangeContent:`.
+ */
+@interface _MRFetchedResultsControllerTraceDelegate : NSObject <MRFetchedResultsControllerDelegate>
+@property (nonatomic, assign) NSUInteger didChangeObjectCount;
+@property (nonatomic, assign) NSUInteger didChangeContentCount;
+@end
+
+
+@implementation _MRFetchedResultsControllerTraceDelegate
+
+- (void)controller:(MRFetchedResultsController *)controller didChangeObject:(id)anObject atIndexPath:(NSIndexPath *)indexPath forChangeType:(MRFetchedResultsChangeType)type newIndexPath:(NSIndexPath *)newIndexPath
+{
+    self.didChangeObjectCount += 1;
+}
+
+- (void)controllerDidChangeContent:(MRFetchedResultsController *)controller
+{
+    self.didChangeContentCount += 1;
+}
+
+- (NSDictionary *)callbackCounts
+{
+    NSMutableDictionary * callbackCounts = [NSMutableDictionary dictionary];
+    if (self.didChangeObjectCount > 0) {
+        callbackCounts[@"controller:didChangeObject:atIndexPath:forChangeType:newIndexPath:"] = @(self.didChangeObjectCount);
+    }
+    if (self.didChangeContentCount > 0) {
+        callbackCounts[@"controllerDidChangeContent:"] = @(self.didChangeContentCount);
+    }
+    return callbackCounts;
+}
+
+@end
+
+
+#pragma mark - MRFetchedResultsControllerTraceTest -
+
+
+/**
+ Test cases for `MRFetchedResultsChangesRecorder` and `MRFetchedResultsChangesPlayer`.
+ */
+@interface MRFetchedResultsControllerTraceTest : XCTestCase
+@property (nonatomic, strong) NSManagedObjectContext *moc;
+@property (nonatomic, strong) NSManagedObject *employee;
+@property (nonatomic, strong) MRFetchedResultsController *resultsController;
+@property (nonatomic, strong) _MRFetchedResultsControllerTraceDelegate *delegate;
+@property (nonatomic, strong) MRFetchedResultsChangesRecorder *recorder;
+
+@end
+
+
+@implementation MRFetchedResultsControllerTraceTest
+
+- (void)mt_setManagedObjectContext
+{
+    NSBundle * bundle = [NSBundle bundleForClass:self.class];
+    NSURL * modelURL = [bundle URLForResource:@"CoreData_Example" withExtension:@"momd"];
+    NSManagedObjectModel * managedObjectModel = [[NSManagedObjectModel alloc] initWithContentsOfURL:modelURL];
+    NSPersistentStoreCoordinator * coordinator =
+    [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:managedObjectModel];
+    [coordinator addPersistentStoreWithType:NSInMemoryStoreType
+                              configuration:nil
+                                        URL:nil
+                                    options:nil
+                                      error:NULL];
+    if (coordinator) {
+        NSManagedObjectContext * managedObjectContext = [[NSManagedObjectContext alloc] init];
+        [managedObjectContext setPersistentStoreCoordinator:coordinator];
+        self.moc = managedObjectContext;
+    }
+}
+
+- (NSManagedObject *)mt_addEmployee:(NSString *)prefix save:(BOOL)save
+{
+    NSManagedObjectContext * moc = self.moc;
+    NSEntityDescription *entity = [NSEntityDescription entityForName:@"Company" inManagedObjectContext:moc];
+    NSManagedObject * company = [[NSManagedObject alloc] initWithEntity:entity insertIntoManagedObjectContext:moc];
+    [company setValue:[NSString stringWithFormat:@"%@-company", prefix] forKey:@"name"];
+    entity = [NSEntityDescription entityForName:@"Project" inManagedObjectContext:moc];
+    NSManagedObject * project = [[NSManagedObject alloc] initWithEntity:entity insertIntoManagedObjectContext:moc];
+    [project setValue:[NSString stringWithFormat:@"%@-project", prefix] forKey:@"name"];
+    [project setValue:company forKey:@"company"];
+    entity = [NSEntityDescription entityForName:@"Employee" inManagedObjectContext:moc];
+    NSManagedObject * employee = [[NSManagedObject alloc] initWithEntity:entity insertIntoManagedObjectContext:moc];
+    [employee setValue:[NSString stringWithFormat:@"%@-first-name", prefix] forKey:@"firstName"];
+    [employee setValue:[NSString stringWithFormat:@"%@-last-name", prefix] forKey:@"lastName"];
+    [employee setValue:[prefix substringToIndex:1] forKey:@"lastNameInitial"];
+    [employee setValue:@(1000) forKey:@"salary"];
+    [employee setValue:company forKey:@"company"];
+    [employee setValue:@(99) forKey:@"extension"];
+    if (save) {
+        [moc save:NULL];
+    }
+    return employee;
+}
+
+- (void)mt_setSampleManagedObjectContext
+{
+    NSMutableArray * properties = [NSMutableArray array];
+    NSDictionary * attributeTypes = @{ @"name": @(NSStringAttributeType),
+                                       @"decimal": @(NSDecimalAttributeType),
+                                       @"double": @(NSDoubleAttributeType),
+                                       @"date": @(NSDateAttributeType),
+                                       @"data": @(NSBinaryDataAttributeType) };
+    for (NSString * name in attributeTypes) {
+        NSAttributeDescription * attribute = [[NSAttributeDescription alloc] init];
+        attribute.name = name;
+        attribute.attributeType = [attributeTypes[name] unsignedIntegerValue];
+        attribute.optional = YES;
+        [properties addObject:attribute];
+    }
+    NSEntityDescription * entity = [[NSEntityDescription alloc] init];
+    entity.name = @"Sample";
+    entity.managedObjectClassName = NSStringFromClass(NSManagedObject.class);
+    entity.properties = properties;
+    NSManagedObjectModel * managedObjectModel = [[NSManagedObjectModel alloc] init];
+    managedObjectModel.entities = @[ entity ];
+    NSPersistentStoreCoordinator * coordinator =
+    [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:managedObjectModel];
+    [coordinator addPersistentStoreWithType:NSInMemoryStoreType
+                              configuration:nil
+                                        URL:nil
+                                    options:nil
+                                      error:NULL];
+    NSManagedObjectContext * managedObjectContext = [[NSManagedObjectContext alloc] init];
+    [managedObjectContext setPersistentStoreCoordinator:coordinator];
+    self.moc = managedObjectContext;
+}
+
+- (void)mt_setResultsControllerWithFetchRequest:(NSFetchRequest *)fetchRequest sectionNameKeyPath:(NSString *)sectionNameKeyPath changesAppliedOnSave:(BOOL)changesAppliedOnSave
+{
+    self.resultsController = [[MRFetchedResultsController alloc] initWithFetchRequest:fetchRequest
+                                                                 managedObjectContext:self.moc
+                                                                   sectionNameKeyPath:sectionNameKeyPath
+                                                                            cacheName:nil];
+    self.resultsController.changesAppliedOnSave = changesAppliedOnSave;
+    self.delegate = _MRFetchedResultsControllerTraceDelegate.new;
+    self.resultsController.delegate = self.delegate;
+    NSError * error;
+    XCTAssertTrue([self.resultsController performFetch:&error]);
+    XCTAssertNil(error);
+    self.recorder = [[MRFetchedResultsChangesRecorder alloc] initWithFetchedResultsController:self.resultsController];
+}
+
+- (void)mt_setResultsControllerWithChangesAppliedOnSave:(BOOL)changesAppliedOnSave
+{
+    NSFetchRequest *fetchRequest = [NSFetchRequest fetchRequestWithEntityName:@"Employee"];
+    fetchRequest.predicate = [NSPredicate predicateWithFormat:@"salary < %@", @(2000)];
+    fetchRequest.sortDescriptors = @[ [NSSortDescriptor sortDescriptorWithKey:@"lastNameInitial" ascending:YES],
+                                      [NSSortDescriptor sortDescriptorWithKey:@"lastName" ascending:YES] ];
+    [self mt_setResultsControllerWithFetchRequest:fetchRequest
+                               sectionNameKeyPath:@"lastNameInitial"
+                             changesAppliedOnSave:changesAppliedOnSave];
+}
+
+- (void)mt_startRecording
+{
+    NSError * error;
+    XCTAssertTrue([self.recorder startRecording:&error]);
+    XCTAssertNil(error);
+}
+
+- (void)mt_recordChanges
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    [self mt_startRecording];
+    NSManagedObject * a1 = [self mt_addEmployee:@"A1" save:NO];
+    [self.moc processPendingChanges];
+    NSManagedObject * b1 = [self mt_addEmployee:@"B1" save:NO];
+    [self.moc processPendingChanges];
+    [self mt_addEmployee:@"C1" save:NO];
+    [self.moc processPendingChanges];
+    [a1 setValue:@"Z" forKey:@"lastNameInitial"];
+    [self.moc processPendingChanges];
+    [b1 setValue:@(3000) forKey:@"salary"];
+    [self.moc processPendingChanges];
+    [self.moc deleteObject:a1];
+    [self.moc processPendingChanges];
+    [self.recorder stopRecording];
+}
+
+- (MRFetchedResultsChangesReport *)mt_replayTrace:(NSDictionary *)trace
+{
+    MRFetchedResultsChangesPlayer * player = [[MRFetchedResultsChangesPlayer alloc] initWithTrace:trace];
+    NSError * error;
+    MRFetchedResultsChangesReport * report = [player replay:&error];
+    XCTAssertNotNil(report);
+    XCTAssertNil(error);
+    return report;
+}
+
+- (NSURL *)mt_temporaryURL
+{
+    NSString * path = [NSTemporaryDirectory() stringByAppendingPathComponent:@"MRFetchedResultsControllerTraceTest.plist"];
+    return [NSURL fileURLWithPath:path];
+}
+
+- (void)setUp
+{
+    [super setUp];
+    [self mt_setManagedObjectContext];
+    self.employee = [self mt_addEmployee:@"Test" save:YES];
+}
+
+- (void)tearDown
+{
+    [_recorder stopRecording];
+    _recorder = nil;
+    _resultsController.delegate = nil;
+    _resultsController = nil;
+    _delegate = nil;
+    _employee = nil;
+    _moc = nil;
+    [[NSFileManager defaultManager] removeItemAtURL:[self mt_temporaryURL] error:NULL];
+    [super tearDown];
+}
+
+- (void)testThatRecorderIsRecording
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    [self mt_startRecording];
+    XCTAssertTrue(self.recorder.isRecording);
+    [self.recorder stopRecording];
+    XCTAssertFalse(self.recorder.isRecording);
+}
+
+- (void)testThatRecorderRecordsEachNotification
+{
+    [self mt_recordChanges];
+    XCTAssertEqual(6, [self.recorder.trace[@"changes"] count]);
+}
+
+- (void)testThatRecorderIgnoresOtherEntities
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    [self mt_startRecording];
+    NSEntityDescription *entity = [NSEntityDescription entityForName:@"Company" inManagedObjectContext:self.moc];
+    NSManagedObject * company = [[NSManagedObject alloc] initWithEntity:entity insertIntoManagedObjectContext:self.moc];
+    [company setValue:@"company" forKey:@"name"];
+    [self.moc processPendingChanges];
+    [self.recorder stopRecording];
+    XCTAssertEqual(0, [self.recorder.trace[@"changes"] count]);
+}
+
+- (void)testThatReplayMatchesRecording
+{
+    [self mt_recordChanges];
+    MRFetchedResultsChangesReport * report = [self mt_replayTrace:self.recorder.trace];
+    XCTAssertNotNil(report.recordedChecksum);
+    XCTAssertTrue(report.matchesRecording);
+}
+
+- (void)testThatReplayReportsLatencyForEachNotification
+{
+    [self mt_recordChanges];
+    MRFetchedResultsChangesReport * report = [self mt_replayTrace:self.recorder.trace];
+    XCTAssertEqual(6, report.latencies.count);
+    XCTAssertEqual(6, report.intervals.count);
+}
+
+- (void)testThatReplayCountsDelegateCallbacks
+{
+    [self mt_recordChanges];
+    MRFetchedResultsChangesReport * report = [self mt_replayTrace:self.recorder.trace];
+    XCTAssertTrue(self.delegate.didChangeObjectCount > 0);
+    XCTAssertEqualObjects(self.delegate.callbackCounts, report.callbackCounts);
+}
+
+- (void)testThatReplayCanBeRepeated
+{
+    [self mt_recordChanges];
+    MRFetchedResultsChangesPlayer * player = [[MRFetchedResultsChangesPlayer alloc] initWithTrace:self.recorder.trace];
+    NSError * error;
+    MRFetchedResultsChangesReport * report = [player replay:&error];
+    XCTAssertNil(error);
+    XCTAssertEqualObjects(report.checksum, [player replay:&error].checksum);
+    XCTAssertNil(error);
+}
+
+- (void)testThatTraceIsWrittenAndRead
+{
+    [self mt_recordChanges];
+    NSURL * url = [self mt_temporaryURL];
+    NSError * error;
+    XCTAssertTrue([self.recorder writeToURL:url error:&error]);
+    XCTAssertNil(error);
+    MRFetchedResultsChangesPlayer * player = [MRFetchedResultsChangesPlayer playerWithContentsOfURL:url error:&error];
+    XCTAssertNotNil(player);
+    XCTAssertNil(error);
+    XCTAssertTrue([player replay:&error].matchesRecording);
+    XCTAssertNil(error);
+}
+
+- (void)testThatReplayMatchesRecordingWhenChangesAreAppliedOnSave
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:YES];
+    [self mt_startRecording];
+    NSManagedObject * a1 = [self mt_addEmployee:@"A1" save:YES];
+    [a1 setValue:@"Z" forKey:@"lastNameInitial"];
+    [self.moc save:NULL];
+    [self mt_addEmployee:@"B1" save:NO];
+    [self.moc deleteObject:self.employee];
+    [self.moc save:NULL];
+    [self.recorder stopRecording];
+    NSArray * changes = self.recorder.trace[@"changes"];
+    XCTAssertEqual(3, changes.count);
+    // the update is recorded with the temporary ID of the insertion
+    XCTAssertEqualObjects(changes[0][@"inserted"][0][@"id"], changes[1][@"updated"][0][@"id"]);
+    MRFetchedResultsChangesReport * report = [self mt_replayTrace:self.recorder.trace];
+    XCTAssertEqual(3, report.latencies.count);
+    XCTAssertEqualObjects(self.delegate.callbackCounts, report.callbackCounts);
+    XCTAssertTrue(report.matchesRecording);
+}
+
+- (void)testThatReplayCreatesMissingObjects
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    [self mt_startRecording];
+    [self.employee setValue:@(1500) forKey:@"salary"];
+    [self.moc processPendingChanges];
+    [self.recorder stopRecording];
+    NSMutableDictionary * trace = self.recorder.trace.mutableCopy;
+    trace[@"snapshot"] = @[];
+    MRFetchedResultsChangesReport * report = [self mt_replayTrace:trace];
+    XCTAssertEqual(1, report.latencies.count);
+    XCTAssertTrue(report.matchesRecording);
+}
+
+- (void)testThatReplayForgetsDeletedObjects
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    [self mt_startRecording];
+    [self.moc deleteObject:self.employee];
+    [self.moc processPendingChanges];
+    [self.recorder stopRecording];
+    NSMutableDictionary * trace = self.recorder.trace.mutableCopy;
+    NSDictionary * deleted = trace[@"changes"][0][@"deleted"][0];
+    // an update of the deleted object is replayed on a new object
+    NSDictionary * updated = @{ @"id": deleted[@"id"],
+                                @"keys": @[ @"salary" ],
+                                @"values": @{ @"firstName": @"first-name", @"lastName": @"last-name", @"salary": @(1500) } };
+    NSDictionary * change = @{ @"deleted": @[], @"inserted": @[], @"updated": @[ updated ], @"time": @(0) };
+    trace[@"changes"] = [trace[@"changes"] arrayByAddingObject:change];
+    MRFetchedResultsChangesReport * report = [self mt_replayTrace:trace];
+    XCTAssertEqual(2, report.latencies.count);
+    XCTAssertEqualObjects(@2, report.callbackCounts[@"controllerDidChangeContent:"]);
+}
+
+- (void)testThatReplayMatchesRecordingOfPendingInsertions
+{
+    [self mt_addEmployee:@"P1" save:NO];
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    [self mt_startRecording];
+    [self.moc processPendingChanges];
+    [self.recorder stopRecording];
+    NSArray * snapshot = self.recorder.trace[@"snapshot"];
+    XCTAssertEqual(1, [snapshot filteredArrayUsingPredicate:[NSPredicate predicateWithFormat:@"pending == YES"]].count);
+    XCTAssertEqual(1, [self.recorder.trace[@"changes"] count]);
+    XCTAssertEqual(1, [self.recorder.trace[@"changes"][0][@"inserted"] count]);
+    MRFetchedResultsChangesReport * report = [self mt_replayTrace:self.recorder.trace];
+    XCTAssertEqualObjects(self.delegate.callbackCounts, report.callbackCounts);
+    XCTAssertTrue(report.matchesRecording);
+}
+
+- (void)testThatReplayKeepsPendingInsertionsWhenCreatingMissingObjects
+{
+    [self mt_addEmployee:@"P1" save:NO];
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    [self mt_startRecording];
+    [self.employee setValue:@(1500) forKey:@"salary"];
+    [self.moc processPendingChanges];
+    [self.recorder stopRecording];
+    NSMutableDictionary * trace = self.recorder.trace.mutableCopy;
+    NSDictionary * change = trace[@"changes"][0];
+    XCTAssertEqual(1, [change[@"inserted"] count]);
+    XCTAssertEqual(1, [change[@"updated"] count]);
+    NSString * identifier = change[@"updated"][0][@"id"];
+    NSMutableArray * snapshot = [NSMutableArray array];
+    for (NSDictionary * record in trace[@"snapshot"]) {
+        if (![record[@"id"] isEqualToString:identifier]) {
+            [snapshot addObject:record];
+        }
+    }
+    XCTAssertEqual(1, snapshot.count);
+    XCTAssertEqualObjects(@YES, snapshot[0][@"pending"]);
+    trace[@"snapshot"] = snapshot;
+    MRFetchedResultsChangesReport * report = [self mt_replayTrace:trace];
+    XCTAssertEqual(1, report.latencies.count);
+    XCTAssertEqualObjects(self.delegate.callbackCounts, report.callbackCounts);
+    XCTAssertTrue(report.matchesRecording);
+}
+
+- (void)testThatReplayMatchesRecordingWhenChangesAreNotApplied
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    self.resultsController.applyFetchedObjectsChanges = NO;
+    [self mt_startRecording];
+    NSManagedObject * a1 = [self mt_addEmployee:@"A1" save:NO];
+    [self.moc processPendingChanges];
+    self.resultsController.applyFetchedObjectsChanges = YES;
+    self.resultsController.applyFetchedObjectsChanges = YES;
+    [a1 setValue:@"Z" forKey:@"lastNameInitial"];
+    [self.moc processPendingChanges];
+    self.resultsController.applyFetchedObjectsChanges = NO;
+    [self.moc deleteObject:a1];
+    [self.moc processPendingChanges];
+    [self.recorder stopRecording];
+    XCTAssertEqualObjects(@NO, self.recorder.trace[@"applyFetchedObjectsChanges"]);
+    XCTAssertEqual(5, [self.recorder.trace[@"changes"] count]);
+    MRFetchedResultsChangesReport * report = [self mt_replayTrace:self.recorder.trace];
+    XCTAssertEqual(5, report.latencies.count);
+    XCTAssertEqualObjects(self.delegate.callbackCounts, report.callbackCounts);
+    XCTAssertTrue(report.matchesRecording);
+}
+
+- (void)testThatChangingChangesAppliedOnSaveStopsRecording
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    [self mt_startRecording];
+    self.resultsController.changesAppliedOnSave = YES;
+    XCTAssertFalse(self.recorder.isRecording);
+    XCTAssertNotNil(self.recorder.trace[@"checksum"]);
+    [self mt_addEmployee:@"A1" save:YES];
+    XCTAssertEqual(0, [self.recorder.trace[@"changes"] count]);
+}
+
+- (void)testThatRecorderRejectsQueuedChanges
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    self.resultsController.applyFetchedObjectsChanges = NO;
+    [self mt_addEmployee:@"A1" save:NO];
+    [self.moc processPendingChanges];
+    NSError * error;
+    XCTAssertFalse([self.recorder startRecording:&error]);
+    XCTAssertEqualObjects(MRFetchedResultsChangesErrorDomain, error.domain);
+    XCTAssertEqual(MRFetchedResultsChangesErrorQueuedChanges, error.code);
+    XCTAssertFalse(self.recorder.isRecording);
+}
+
+- (void)testThatPerformingFetchStopsRecording
+{
+    [self mt_setResultsControllerWithChangesAppliedOnSave:NO];
+    [self mt_startRecording];
+    self.resultsController.fetchRequest.predicate = [NSPredicate predicateWithFormat:@"salary < %@", @(1000)];
+    NSError * error;
+    XCTAssertTrue([self.resultsController performFetch:&error]);
+    XCTAssertNil(error);
+    XCTAssertFalse(self.recorder.isRecording);
+    XCTAssertNil(self.recorder.trace[@"checksum"]);
+    [self mt_addEmployee:@"A1" save:NO];
+    [self.moc processPendingChanges];
+    XCTAssertEqual(0, [self.recorder.trace[@"changes"] count]);
+}
+
+- (void)testThatAttributeValuesAreReplayed
+{
+    [self mt_setSampleManagedObjectContext];
+    NSFetchRequest *fetchRequest = [NSFetchRequest fetchRequestWithEntityName:@"Sample"];
+    fetchRequest.predicate = [NSPredicate predicateWithFormat:@"date > %@", [NSDate dateWithTimeIntervalSinceReferenceDate:0]];
+    fetchRequest.sortDescriptors = @[ [NSSortDescriptor sortDescriptorWithKey:@"name" ascending:YES] ];
+    [self mt_setResultsControllerWithFetchRequest:fetchRequest sectionNameKeyPath:nil changesAppliedOnSave:NO];
+    [self mt_startRecording];
+    NSManagedObject * sample = [NSEntityDescription insertNewObjectForEntityForName:@"Sample" inManagedObjectContext:self.moc];
+    [sample setValue:@"sample" forKey:@"name"];
+    [sample setValue:[NSDecimalNumber decimalNumberWithString:@"12345.6789012345678901234567890123"] forKey:@"decimal"];
+    [sample setValue:@(M_PI) forKey:@"double"];
+    [sample setValue:[NSDate dateWithTimeIntervalSinceReferenceDate:123456789.123456789] forKey:@"date"];
+    [sample setValue:[@"data" dataUsingEncoding:NSUTF8StringEncoding] forKey:@"data"];
+    [self.moc processPendingChanges];
+    [sample setValue:[NSDate dateWithTimeIntervalSinceReferenceDate:987654321.987654321] forKey:@"date"];
+    [self.moc processPendingChanges];
+    [self.recorder stopRecording];
+    NSURL * url = [self mt_temporaryURL];
+    NSError * error;
+    XCTAssertTrue([self.recorder writeToURL:url error:&error]);
+    XCTAssertNil(error);
+    MRFetchedResultsChangesPlayer * player = [MRFetchedResultsChangesPlayer playerWithContentsOfURL:url error:&error];
+    XCTAssertNil(error);
+    MRFetchedResultsChangesReport * report = [player replay:&error];
+    XCTAssertNil(error);
+    XCTAssertEqual(2, report.latencies.count);
+    XCTAssertTrue(report.matchesRecording);
+}
+
+- (void)testThatRecorderRejectsRelationshipKeyPaths
+{
+    NSFetchRequest *fetchRequest = [NSFetchRequest fetchRequestWithEntityName:@"Employee"];
+    fetchRequest.predicate = [NSPredicate predicateWithFormat:@"company == %@", [self.employee valueForKey:@"company"]];
+    fetchRequest.sortDescriptors = @[ [NSSortDescriptor sortDescriptorWithKey:@"lastName" ascending:YES] ];
+    [self mt_setResultsControllerWithFetchRequest:fetchRequest sectionNameKeyPath:nil changesAppliedOnSave:NO];
+    NSError * error;
+    XCTAssertFalse([self.recorder startRecording:&error]);
+    XCTAssertEqualObjects(MRFetchedResultsChangesErrorDomain, error.domain);
+    XCTAssertEqual(MRFetchedResultsChangesErrorUnsupportedFetchRequest, error.code);
+    XCTAssertFalse(self.recorder.isRecording);
+    XCTAssertNil(self.recorder.trace);
+}
+
+- (void)testThatRecorderRejectsBlockPredicates
+{
+    NSFetchRequest *fetchRequest = [NSFetchRequest fetchRequestWithEntityName:@"Employee"];
+    fetchRequest.sortDescriptors = @[ [NSSortDescriptor sortDescriptorWithKey:@"lastName" ascending:YES] ];
+    [self mt_setResultsControllerWithFetchRequest:fetchRequest sectionNameKeyPath:nil changesAppliedOnSave:NO];
+    self.resultsController.fetchRequest.predicate = [NSPredicate predicateWithBlock:^BOOL(id evaluatedObject, NSDictionary *bindings) {
+        return YES;
+    }];
+    NSError * error;
+    XCTAssertFalse([self.recorder startRecording:&error]);
+    XCTAssertEqual(MRFetchedResultsChangesErrorUnsupportedFetchRequest, error.code);
+    XCTAssertFalse(self.recorder.isRecording);
+}
+
+- (void)testThatReplayRejectsRelationshipKeyPaths
+{
+    [self mt_recordChanges];
+    NSMutableDictionary * trace = self.recorder.trace.mutableCopy;
+    trace[@"sectionNameKeyPath"] = @"company.name";
+    MRFetchedResultsChangesPlayer * player = [[MRFetchedResultsChangesPlayer alloc] initWithTrace:trace];
+    NSError * error;
+    XCTAssertNil([player replay:&error]);
+    XCTAssertEqualObjects(MRFetchedResultsChangesErrorDomain, error.domain);
+    XCTAssertEqual(MRFetchedResultsChangesErrorUnsupportedFetchRequest, error.code);
+}
+
+- (void)testThatPlayerRejectsInvalidTraces
+{
+    NSURL * url = [self mt_temporaryURL];
+    XCTAssertTrue([@[ @1 ] writeToURL:url atomically:YES]);
+    NSError * error;
+    XCTAssertNil([MRFetchedResultsChangesPlayer playerWithContentsOfURL:url error:&error]);
+    XCTAssertEqualObjects(MRFetchedResultsChangesErrorDomain, error.domain);
+    XCTAssertEqual(MRFetchedResultsChangesErrorInvalidTrace, error.code);
+}
+
+- (void)testThatPlayerRejectsUnsupportedVersions
+{
+    [self mt_recordChanges];
+    NSMutableDictionary * trace = self.recorder.trace.mutableCopy;
+    trace[@"version"] = @(99);
+    NSURL * url = [self mt_temporaryURL];
+    XCTAssertTrue([trace writeToURL:url atomically:YES]);
+    NSError * error;
+    XCTAssertNil([MRFetchedResultsChangesPlayer playerWithContentsOfURL:url error:&error]);
+    XCTAssertEqualObjects(MRFetchedResultsChangesErrorDomain, error.domain);
+    XCTAssertEqual(MRFetchedResultsChangesErrorInvalidTrace, error.code);
+}
+
+- (void)testThatPlayerRejectsMalformedTraces
+{
+    [self mt_recordChanges];
+    NSURL * url = [self mt_temporaryURL];
+    NSMutableDictionary * trace = self.recorder.trace.mutableCopy;
+    trace[@"entityName"] = @[ @"Employee" ];
+    XCTAssertTrue([trace writeToURL:url atomically:YES]);
+    NSError * error;
+    XCTAssertNil([MRFetchedResultsChangesPlayer playerWithContentsOfURL:url error:&error]);
+    XCTAssertEqual(MRFetchedResultsChangesErrorInvalidTrace, error.code);
+    trace = self.recorder.trace.mutableCopy;
+    trace[@"changes"] = @[ @{ @"deleted": @[], @"inserted": @"Employee", @"updated": @[] } ];
+    XCTAssertTrue([trace writeToURL:url atomically:YES]);
+    error = nil;
+    XCTAssertNil([MRFetchedResultsChangesPlayer playerWithContentsOfURL:url error:&error]);
+    XCTAssertEqual(MRFetchedResultsChangesErrorInvalidTrace, error.code);
+    trace = self.recorder.trace.mutableCopy;
+    trace[@"snapshot"] = @[ @{ @"id": @"employee", @"values": @{ @"salary": @"1000" } } ];
+    XCTAssertTrue([trace writeToURL:url atomically:YES]);
+    error = nil;
+    XCTAssertNil([MRFetchedResultsChangesPlayer playerWithContentsOfURL:url error:&error]);
+    XCTAssertEqual(MRFetchedResultsChangesErrorInvalidTrace, error.code);
+}
+
+@end
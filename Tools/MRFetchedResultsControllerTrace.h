@@ -0,0 +1,191 @@
+// MRFetchedResultsControllerTrace.h
+//
+// Copyright (c) 2015 Héctor Marqués
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import <Foundation/Foundation.h>
+
+@class MRFetchedResultsController, MRFetchedResultsChangesReport;
+
+
+/**
+ Domain of the errors returned by `MRFetchedResultsChangesRecorder` and `MRFetchedResultsChangesPlayer`.
+ */
+extern NSString *const MRFetchedResultsChangesErrorDomain;
+
+/** Codes of the errors in `MRFetchedResultsChangesErrorDomain`. */
+typedef NS_ENUM(NSInteger, MRFetchedResultsChangesErrorCode) {
+    /** The trace is not a dictionary recorded by a compatible version of `MRFetchedResultsChangesRecorder`. */
+    MRFetchedResultsChangesErrorInvalidTrace = 1,
+    /** The fetch request or the section name key path uses something that can't be recorded or replayed. */
+    MRFetchedResultsChangesErrorUnsupportedFetchRequest = 2,
+    /** The controller holds changes that were queued while `applyFetchedObjectsChanges` was not set. */
+    MRFetchedResultsChangesErrorQueuedChanges = 3
+};
+
+
+/**
+ Records the change sets received by a `MRFetchedResultsController` so that they can be replayed offline with `MRFetchedResultsChangesPlayer`.
+
+ The trace contains the fetch request configuration, the attributes of the fetched entity, a snapshot of the objects of that entity that exist when the recording starts and, for each managed object context notification, the identifiers of the deleted, inserted and updated objects along with their changed keys and attribute values.
+
+ Only attributes whose values can be stored in a property list are recorded; relationships are not. Hence the predicate, the sort descriptors and the section name key path may only use key paths that start with a recorded attribute, and the predicate may only contain property list constants (no managed objects, blocks or subqueries).
+
+ Changes of `applyFetchedObjectsChanges` made while recording are recorded too, but changes queued before recording starts are not; hence recording can't start while the controller holds queued changes. Changing `changesAppliedOnSave` stops the recording. Performing a fetch also stops the recording, leaving the trace without a checksum since the results of the new fetch request can't be replayed.
+ */
+@interface MRFetchedResultsChangesRecorder : NSObject
+
+/**
+ Initializes an instance of `MRFetchedResultsChangesRecorder`.
+
+ @param controller The fetched results controller whose changes will be recorded.
+ @return The receiver initialized with the given controller.
+ */
+- (id)initWithFetchedResultsController:(MRFetchedResultsController *)controller;
+
+/**
+ The fetched results controller whose changes are recorded.
+ */
+@property (nonatomic, strong, readonly) MRFetchedResultsController *fetchedResultsController;
+
+/**
+ Set while the receiver is recording.
+ */
+@property (nonatomic, assign, readonly, getter=isRecording) BOOL recording;
+
+/**
+ Takes a snapshot of the controller's entity objects and starts listening to the same notification as the controller.
+
+ The controller must have performed its fetch before invoking this method. Any previously recorded trace is discarded.
+
+ @param errorPtr If the controller can't be recorded, upon return contains an error object describing the problem.
+ @return `YES` if the recording started or `NO` otherwise.
+ */
+- (BOOL)startRecording:(NSError **)errorPtr;
+
+/**
+ Stops listening to notifications and stores the checksum of the controller's final state in the trace.
+ */
+- (void)stopRecording;
+
+/**
+ The recorded trace as a property list.
+ */
+@property (nonatomic, strong, readonly) NSDictionary<NSString *, id> *trace;
+
+/**
+ Writes the recorded trace to the given URL as a binary property list.
+
+ @param url The location of the trace file.
+ @param errorPtr If the trace can't be written, upon return contains an error object describing the problem.
+ @return `YES` if successful or `NO` otherwise.
+ */
+- (BOOL)writeToURL:(NSURL *)url error:(NSError **)errorPtr;
+
+@end
+
+
+/**
+ Rebuilds an in-memory store from a trace recorded by `MRFetchedResultsChangesRecorder` and drives a new `MRFetchedResultsController` through the recorded change sets.
+ */
+@interface MRFetchedResultsChangesPlayer : NSObject
+
+/**
+ Initializes an instance of `MRFetchedResultsChangesPlayer`.
+
+ @param trace A trace returned by `- [MRFetchedResultsChangesRecorder trace]`.
+ @return The receiver initialized with the given trace.
+ */
+- (id)initWithTrace:(NSDictionary<NSString *, id> *)trace;
+
+/**
+ Creates a player with the trace stored at the given URL.
+
+ @param url The location of a trace file written by `- [MRFetchedResultsChangesRecorder writeToURL:error:]`.
+ @param errorPtr If the trace can't be read, upon return contains an error object describing the problem.
+ @return A new player, or `nil` if the trace can't be read.
+ */
++ (instancetype)playerWithContentsOfURL:(NSURL *)url error:(NSError **)errorPtr;
+
+/**
+ The trace that will be replayed.
+ */
+@property (nonatomic, strong, readonly) NSDictionary<NSString *, id> *trace;
+
+/**
+ Replays the trace synchronously in the current thread.
+
+ Each call builds a new store and a new controller, so the receiver can be replayed repeatedly.
+
+ @param errorPtr If the trace can't be replayed or the store can't be built or saved, upon return contains an error object describing the problem.
+ @return The report of the replay, or `nil` if it fails.
+ */
+- (MRFetchedResultsChangesReport *)replay:(NSError **)errorPtr;
+
+@end
+
+
+/**
+ Measurements taken by `MRFetchedResultsChangesPlayer` while replaying a trace.
+ */
+@interface MRFetchedResultsChangesReport : NSObject
+
+/**
+ Time spent by the controller on each recorded entry, in seconds.
+
+ Entries are either notifications, measured in `mr_updateContent:`, or changes of `applyFetchedObjectsChanges`, measured in its setter.
+ */
+@property (nonatomic, strong, readonly) NSArray<NSNumber *> *latencies;
+
+/**
+ Sum of `latencies`, in seconds.
+ */
+@property (nonatomic, assign, readonly) NSTimeInterval totalLatency;
+
+/**
+ Time elapsed in the recorded session before each entry, since the previous entry or since the recording started, in seconds.
+ */
+@property (nonatomic, strong, readonly) NSArray<NSNumber *> *intervals;
+
+/**
+ Number of delegate invocations by selector name.
+
+ Only the delegate methods implemented by the recorded controller's delegate are implemented by the replay delegate.
+ */
+@property (nonatomic, strong, readonly) NSDictionary<NSString *, NSNumber *> *callbackCounts;
+
+/**
+ Checksum of the sections, object identifiers and attribute values of the replayed controller after the last notification.
+
+ Objects that compare as equal under the sort descriptors may be ordered differently than in the recording, producing a different checksum.
+ */
+@property (nonatomic, strong, readonly) NSString *checksum;
+
+/**
+ Checksum of the recorded controller when the recording stopped, or `nil` if the recording wasn't stopped.
+ */
+@property (nonatomic, strong, readonly) NSString *recordedChecksum;
+
+/**
+ Set when `checksum` is equal to `recordedChecksum`.
+ */
+@property (nonatomic, assign, readonly) BOOL matchesRecording;
+
+@end
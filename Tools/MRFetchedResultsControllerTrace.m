@@ -0,0 +1,1404 @@
+// MRFetchedResultsControllerTrace.m
+//
+// Copyright (c) 2015 Héctor Marqués
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in
+// all copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+// THE SOFTWARE.
+
+#import "MRFetchedResultsControllerTrace.h"
+#import "MRFetchedResultsController.h"
+#import "MRFetchedResultsController_Internal.h"
+
+#import <CoreData/CoreData.h>
+
+
+NSString *const MRFetchedResultsChangesErrorDomain = @"MRFetchedResultsChangesErrorDomain";
+
+static void *const MRFetchedResultsChangesRecorderContext = (void *)&MRFetchedResultsChangesRecorderContext;
+
+static NSUInteger const MRTraceVersion = 1;
+
+static NSString *const MRTraceVersionKey = @"version";
+static NSString *const MRTraceEntityNameKey = @"entityName";
+static NSString *const MRTraceAttributesKey = @"attributes";
+static NSString *const MRTracePredicateKey = @"predicate";
+static NSString *const MRTraceSortDescriptorsKey = @"sortDescriptors";
+static NSString *const MRTraceSectionNameKeyPathKey = @"sectionNameKeyPath";
+static NSString *const MRTraceChangesAppliedOnSaveKey = @"changesAppliedOnSave";
+static NSString *const MRTraceApplyFetchedObjectsChangesKey = @"applyFetchedObjectsChanges";
+static NSString *const MRTraceDelegateSelectorsKey = @"delegateSelectors";
+static NSString *const MRTraceSnapshotKey = @"snapshot";
+static NSString *const MRTraceChangesKey = @"changes";
+static NSString *const MRTraceChecksumKey = @"checksum";
+static NSString *const MRTraceTimeKey = @"time";
+static NSString *const MRTraceDeletedKey = @"deleted";
+static NSString *const MRTraceInsertedKey = @"inserted";
+static NSString *const MRTraceUpdatedKey = @"updated";
+static NSString *const MRTraceIdentifierKey = @"id";
+static NSString *const MRTracePendingKey = @"pending";
+static NSString *const MRTraceKeysKey = @"keys";
+static NSString *const MRTraceValuesKey = @"values";
+
+
+#pragma mark - MRFetchedResultsChangesTrace -
+
+
+/**
+ Helpers for validating, archiving and checksumming traces, shared by the recorder and the player.
+ */
+@interface MRFetchedResultsChangesTrace : NSObject
+
+/**
+ Returns `YES` if values of attributes of the given type can be stored in a trace.
+ */
++ (BOOL)mr_isSupportedAttributeType:(NSAttributeType)attributeType;
+
+/**
+ Returns the string used for representing the given attribute value in the checksums.
+
+ Numbers and dates are formatted with their full precision so that values read back from a trace produce the same string.
+ */
++ (NSString *)mr_canonicalValue:(id)value ofType:(NSAttributeType)attributeType;
+
+/**
+ Calculates a checksum of the given sections, including their names, the identifiers of their objects and the values of the given attributes.
+
+ @param sections The sections of a fetched results controller.
+ @param attributeTypes The types of the attributes included in the checksum by attribute name.
+ @param identifiers Trace identifiers by managed object. Objects not found in this table are identified by their object ID.
+ @return A hexadecimal string.
+ */
++ (NSString *)mr_checksumForSections:(NSArray<id<MRFetchedResultsSectionInfo>> *)sections
+                      attributeTypes:(NSDictionary<NSString *, NSNumber *> *)attributeTypes
+                         identifiers:(NSMapTable *)identifiers;
+
+/**
+ Returns an error in `MRFetchedResultsChangesErrorDomain` with the given code and description.
+ */
++ (NSError *)mr_errorWithCode:(MRFetchedResultsChangesErrorCode)code description:(NSString *)description;
+
+/**
+ Checks that the given object is a trace of the current version whose entries and records have the expected types.
+
+ @param trace The object to check.
+ @param errorPtr If the object is not a valid trace, upon return contains an error object describing the problem.
+ @return `YES` if the object is a valid trace or `NO` otherwise.
+ */
++ (BOOL)mr_validateTrace:(id)trace error:(NSError **)errorPtr;
+
+/**
+ Checks that the given predicate, sort descriptors and section name key path can be evaluated against objects that only have the given attributes, and that they can be archived.
+
+ @param predicate The predicate of the fetch request or `nil`.
+ @param sortDescriptors The sort descriptors of the fetch request.
+ @param sectionNameKeyPath The section name key path of the controller or `nil`.
+ @param attributeTypes The types of the recorded attributes by attribute name.
+ @param errorPtr If the fetch request is not supported, upon return contains an error object describing the problem.
+ @return `YES` if the fetch request is supported or `NO` otherwise.
+ */
++ (BOOL)mr_validatePredicate:(NSPredicate *)predicate
+             sortDescriptors:(NSArray<NSSortDescriptor *> *)sortDescriptors
+          sectionNameKeyPath:(NSString *)sectionNameKeyPath
+              attributeTypes:(NSDictionary<NSString *, NSNumber *> *)attributeTypes
+                       error:(NSError **)errorPtr;
+
+/**
+ Archives the given object, returning an error instead of raising if it can't be archived.
+ */
++ (NSData *)mr_archivedDataWithRootObject:(id)rootObject error:(NSError **)errorPtr;
+
+/**
+ Unarchives an object of the given class, returning an error instead of raising if the data is not valid.
+ */
++ (id)mr_unarchiveObjectOfClass:(Class)aClass withData:(NSData *)data error:(NSError **)errorPtr;
+
+@end
+
+
+@implementation MRFetchedResultsChangesTrace
+
++ (BOOL)mr_isSupportedAttributeType:(NSAttributeType const)attributeType
+{
+    switch (attributeType) {
+        case NSInteger16AttributeType:
+        case NSInteger32AttributeType:
+        case NSInteger64AttributeType:
+        case NSDecimalAttributeType:
+        case NSDoubleAttributeType:
+        case NSFloatAttributeType:
+        case NSStringAttributeType:
+        case NSBooleanAttributeType:
+        case NSDateAttributeType:
+        case NSBinaryDataAttributeType:
+            return YES;
+        default:
+            return NO;
+    }
+}
+
++ (NSString *)mr_canonicalValue:(id const)value ofType:(NSAttributeType const)attributeType
+{
+    if (value == nil || value == NSNull.null) {
+        return @"nil";
+    }
+    switch (attributeType) {
+        case NSInteger16AttributeType:
+        case NSInteger32AttributeType:
+        case NSInteger64AttributeType:
+        case NSBooleanAttributeType:
+            return [NSString stringWithFormat:@"%lld", [value longLongValue]];
+        case NSFloatAttributeType:
+            return [NSString stringWithFormat:@"%.9g", [value floatValue]];
+        case NSDoubleAttributeType:
+            return [NSString stringWithFormat:@"%.17g", [value doubleValue]];
+        case NSDateAttributeType:
+            return [NSString stringWithFormat:@"%.17g", [value timeIntervalSinceReferenceDate]];
+        default:
+            return [value description];
+    }
+}
+
++ (NSString *)mr_checksumForSections:(NSArray *const)sections
+                      attributeTypes:(NSDictionary *const)attributeTypes
+                         identifiers:(NSMapTable *const)identifiers
+{
+    NSArray *const keys = [attributeTypes.allKeys sortedArrayUsingSelector:@selector(compare:)];
+    NSMutableString *const canonical = NSMutableString.string;
+    for (id<MRFetchedResultsSectionInfo> const sectionInfo in sections) {
+        [canonical appendFormat:@"[%@:%lu]\n", sectionInfo.name, (unsigned long)sectionInfo.numberOfObjects];
+        for (NSManagedObject *const object in sectionInfo.objects) {
+            NSString *const identifier = ([identifiers objectForKey:object] ?: object.objectID.URIRepresentation.absoluteString);
+            [canonical appendString:identifier];
+            for (NSString *const key in keys) {
+                NSAttributeType const attributeType = [attributeTypes[key] unsignedIntegerValue];
+                NSString *const value = [self mr_canonicalValue:[object valueForKey:key] ofType:attributeType];
+                [canonical appendFormat:@"|%@=%@", key, value];
+            }
+            [canonical appendString:@"\n"];
+        }
+    }
+    // FNV-1a
+    NSData *const data = [canonical dataUsingEncoding:NSUTF8StringEncoding];
+    uint8_t const *const bytes = data.bytes;
+    uint64_t hash = 14695981039346656037ULL;
+    for (NSUInteger i = 0; i < data.length; i++) {
+        hash ^= bytes[i];
+        hash *= 1099511628211ULL;
+    }
+    return [NSString stringWithFormat:@"%016llx", (unsigned long long)hash];
+}
+
++ (NSError *)mr_errorWithCode:(MRFetchedResultsChangesErrorCode const)code description:(NSString *const)description
+{
+    return [NSError errorWithDomain:MRFetchedResultsChangesErrorDomain
+                               code:code
+                           userInfo:@{ NSLocalizedDescriptionKey: description }];
+}
+
++ (BOOL)mr_validateTrace:(id const)trace error:(NSError **const)errorPtr
+{
+    NSString *const description = [self mr_invalidReasonForTrace:trace];
+    if (description) {
+        if (errorPtr) {
+            *errorPtr = [self mr_errorWithCode:MRFetchedResultsChangesErrorInvalidTrace description:description];
+        }
+        return NO;
+    }
+    return YES;
+}
+
++ (NSString *)mr_invalidReasonForTrace:(id const)trace
+{
+    if (![trace isKindOfClass:NSDictionary.class]) {
+        return @"The trace is not a dictionary.";
+    }
+    id const version = trace[MRTraceVersionKey];
+    if (![version isKindOfClass:NSNumber.class] || [version unsignedIntegerValue] != MRTraceVersion) {
+        return [NSString stringWithFormat:@"Unsupported trace version %@.", version];
+    }
+    NSString *const invalidFormat = @"The trace has no valid '%@' entry.";
+    // header
+    NSDictionary *const requiredClasses = @{ MRTraceEntityNameKey: NSString.class,
+                                             MRTraceSortDescriptorsKey: NSData.class,
+                                             MRTraceChangesAppliedOnSaveKey: NSNumber.class,
+                                             MRTraceApplyFetchedObjectsChangesKey: NSNumber.class };
+    NSDictionary *const optionalClasses = @{ MRTracePredicateKey: NSData.class,
+                                             MRTraceSectionNameKeyPathKey: NSString.class,
+                                             MRTraceChecksumKey: NSString.class };
+    for (NSString *const key in requiredClasses) {
+        if (![trace[key] isKindOfClass:requiredClasses[key]]) {
+            return [NSString stringWithFormat:invalidFormat, key];
+        }
+    }
+    for (NSString *const key in optionalClasses) {
+        if (trace[key] && ![trace[key] isKindOfClass:optionalClasses[key]]) {
+            return [NSString stringWithFormat:invalidFormat, key];
+        }
+    }
+    if (![self mr_isArray:trace[MRTraceDelegateSelectorsKey] ofClass:NSString.class]) {
+        return [NSString stringWithFormat:invalidFormat, MRTraceDelegateSelectorsKey];
+    }
+    NSDictionary *const attributeTypes = trace[MRTraceAttributesKey];
+    if (![attributeTypes isKindOfClass:NSDictionary.class]) {
+        return [NSString stringWithFormat:invalidFormat, MRTraceAttributesKey];
+    }
+    for (NSString *const name in attributeTypes) {
+        NSNumber *const attributeType = attributeTypes[name];
+        if (![attributeType isKindOfClass:NSNumber.class]
+            || ![self mr_isSupportedAttributeType:attributeType.unsignedIntegerValue]) {
+            return [NSString stringWithFormat:invalidFormat, MRTraceAttributesKey];
+        }
+    }
+    // snapshot
+    NSArray *const snapshot = trace[MRTraceSnapshotKey];
+    if (![snapshot isKindOfClass:NSArray.class]) {
+        return [NSString stringWithFormat:invalidFormat, MRTraceSnapshotKey];
+    }
+    for (NSDictionary *const record in snapshot) {
+        if (![self mr_isRecord:record withKeys:NO values:YES attributeTypes:attributeTypes]
+            || (record[MRTracePendingKey] && ![record[MRTracePendingKey] isKindOfClass:NSNumber.class])) {
+            return [NSString stringWithFormat:invalidFormat, MRTraceSnapshotKey];
+        }
+    }
+    // changes
+    NSArray *const changes = trace[MRTraceChangesKey];
+    if (![self mr_isArray:changes ofClass:NSDictionary.class]) {
+        return [NSString stringWithFormat:invalidFormat, MRTraceChangesKey];
+    }
+    for (NSDictionary *const change in changes) {
+        BOOL isValid = (change[MRTraceTimeKey] == nil || [change[MRTraceTimeKey] isKindOfClass:NSNumber.class]);
+        id const applyFetchedObjectsChanges = change[MRTraceApplyFetchedObjectsChangesKey];
+        if (applyFetchedObjectsChanges) {
+            isValid = (isValid && [applyFetchedObjectsChanges isKindOfClass:NSNumber.class]);
+        } else {
+            isValid = (isValid
+                       && [self mr_areRecords:change[MRTraceDeletedKey] withKeys:NO values:NO attributeTypes:attributeTypes]
+                       && [self mr_areRecords:change[MRTraceInsertedKey] withKeys:NO values:YES attributeTypes:attributeTypes]
+                       && [self mr_areRecords:change[MRTraceUpdatedKey] withKeys:YES values:YES attributeTypes:attributeTypes]);
+        }
+        if (!isValid) {
+            return [NSString stringWithFormat:invalidFormat, MRTraceChangesKey];
+        }
+    }
+    return nil;
+}
+
++ (BOOL)mr_isArray:(id const)array ofClass:(Class const)aClass
+{
+    if (![array isKindOfClass:NSArray.class]) {
+        return NO;
+    }
+    for (id const element in array) {
+        if (![element isKindOfClass:aClass]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
++ (BOOL)mr_areRecords:(id const)records
+             withKeys:(BOOL const)hasKeys
+               values:(BOOL const)hasValues
+       attributeTypes:(NSDictionary *const)attributeTypes
+{
+    if (![records isKindOfClass:NSArray.class]) {
+        return NO;
+    }
+    for (id const record in records) {
+        if (![self mr_isRecord:record withKeys:hasKeys values:hasValues attributeTypes:attributeTypes]) {
+            return NO;
+        }
+    }
+    return YES;
+}
+
++ (BOOL)mr_isRecord:(id const)record
+           withKeys:(BOOL const)hasKeys
+             values:(BOOL const)hasValues
+     attributeTypes:(NSDictionary *const)attributeTypes
+{
+    if (![record isKindOfClass:NSDictionary.class] || ![record[MRTraceIdentifierKey] isKindOfClass:NSString.class]) {
+        return NO;
+    }
+    if (hasKeys && ![self mr_isArray:record[MRTraceKeysKey] ofClass:NSString.class]) {
+        return NO;
+    }
+    if (hasValues) {
+        NSDictionary *const values = record[MRTraceValuesKey];
+        if (![values isKindOfClass:NSDictionary.class]) {
+            return NO;
+        }
+        for (NSString *const key in values) {
+            NSNumber *const attributeType = attributeTypes[key];
+            if (attributeType && ![self mr_isValue:values[key] ofType:attributeType.unsignedIntegerValue]) {
+                return NO;
+            }
+        }
+    }
+    return YES;
+}
+
++ (BOOL)mr_isValue:(id const)value ofType:(NSAttributeType const)attributeType
+{
+    switch (attributeType) {
+        case NSInteger16AttributeType:
+        case NSInteger32AttributeType:
+        case NSInteger64AttributeType:
+        case NSDoubleAttributeType:
+        case NSFloatAttributeType:
+        case NSBooleanAttributeType:
+            return [value isKindOfClass:NSNumber.class];
+        case NSDecimalAttributeType:
+        case NSStringAttributeType:
+            return [value isKindOfClass:NSString.class];
+        case NSDateAttributeType:
+            return [value isKindOfClass:NSDate.class];
+        case NSBinaryDataAttributeType:
+            return [value isKindOfClass:NSData.class];
+        default:
+            return NO;
+    }
+}
+
++ (BOOL)mr_isArchivableConstant:(id const)constant
+{
+    if (constant == nil
+        || [constant isKindOfClass:NSNull.class]
+        || [constant isKindOfClass:NSString.class]
+        || [constant isKindOfClass:NSNumber.class]
+        || [constant isKindOfClass:NSDate.class]
+        || [constant isKindOfClass:NSData.class]) {
+        return YES;
+    }
+    if ([constant isKindOfClass:NSArray.class]
+        || [constant isKindOfClass:NSSet.class]
+        || [constant isKindOfClass:NSOrderedSet.class]) {
+        for (id const element in constant) {
+            if (![self mr_isArchivableConstant:element]) {
+                return NO;
+            }
+        }
+        return YES;
+    }
+    return NO;
+}
+
++ (BOOL)mr_isRecordedKeyPath:(NSString *const)keyPath attributeTypes:(NSDictionary *const)attributeTypes
+{
+    NSString *const key = [keyPath componentsSeparatedByString:@"."].firstObject;
+    return (attributeTypes[key] != nil);
+}
+
++ (NSString *)mr_unsupportedReasonForExpression:(NSExpression *const)expression
+                                 attributeTypes:(NSDictionary *const)attributeTypes
+{
+    switch (expression.expressionType) {
+        case NSConstantValueExpressionType:
+            if (![self mr_isArchivableConstant:expression.constantValue]) {
+                return [NSString stringWithFormat:@"constant %@ is not a property list value", expression.constantValue];
+            }
+            return nil;
+        case NSEvaluatedObjectExpressionType:
+        case NSVariableExpressionType:
+            return nil;
+        case NSKeyPathExpressionType:
+            if (![self mr_isRecordedKeyPath:expression.keyPath attributeTypes:attributeTypes]) {
+                return [NSString stringWithFormat:@"key path '%@' doesn't start with a recorded attribute", expression.keyPath];
+            }
+            return nil;
+        case NSFunctionExpressionType: {
+            NSMutableArray *const expressions = [NSMutableArray arrayWithObject:expression.operand];
+            [expressions addObjectsFromArray:expression.arguments];
+            for (NSExpression *const subexpression in expressions) {
+                NSString *const reason = [self mr_unsupportedReasonForExpression:subexpression attributeTypes:attributeTypes];
+                if (reason) {
+                    return reason;
+                }
+            }
+            return nil;
+        }
+        case NSAggregateExpressionType:
+            for (NSExpression *const subexpression in expression.collection) {
+                NSString *const reason = [self mr_unsupportedReasonForExpression:subexpression attributeTypes:attributeTypes];
+                if (reason) {
+                    return reason;
+                }
+            }
+            return nil;
+        case NSUnionSetExpressionType:
+        case NSIntersectSetExpressionType:
+        case NSMinusSetExpressionType:
+            return ([self mr_unsupportedReasonForExpression:expression.leftExpression attributeTypes:attributeTypes]
+                    ?: [self mr_unsupportedReasonForExpression:expression.rightExpression attributeTypes:attributeTypes]);
+        default:
+            return [NSString stringWithFormat:@"expression %@ is not supported", expression];
+    }
+}
+
++ (NSString *)mr_unsupportedReasonForPredicate:(NSPredicate *const)predicate
+                                attributeTypes:(NSDictionary *const)attributeTypes
+{
+    if ([predicate isKindOfClass:NSCompoundPredicate.class]) {
+        for (NSPredicate *const subpredicate in [(NSCompoundPredicate *)predicate subpredicates]) {
+            NSString *const reason = [self mr_unsupportedReasonForPredicate:subpredicate attributeTypes:attributeTypes];
+            if (reason) {
+                return reason;
+            }
+        }
+        return nil;
+    }
+    if ([predicate isKindOfClass:NSComparisonPredicate.class]) {
+        NSComparisonPredicate *const comparisonPredicate = (NSComparisonPredicate *)predicate;
+        return ([self mr_unsupportedReasonForExpression:comparisonPredicate.leftExpression attributeTypes:attributeTypes]
+                ?: [self mr_unsupportedReasonForExpression:comparisonPredicate.rightExpression attributeTypes:attributeTypes]);
+    }
+    NSString *const predicateFormat = predicate.predicateFormat;
+    if ([predicateFormat isEqualToString:@"TRUEPREDICATE"] || [predicateFormat isEqualToString:@"FALSEPREDICATE"]) {
+        return nil;
+    }
+    return [NSString stringWithFormat:@"predicate %@ is not supported", predicateFormat];
+}
+
++ (BOOL)mr_validatePredicate:(NSPredicate *const)predicate
+             sortDescriptors:(NSArray *const)sortDescriptors
+          sectionNameKeyPath:(NSString *const)sectionNameKeyPath
+              attributeTypes:(NSDictionary *const)attributeTypes
+                       error:(NSError **const)errorPtr
+{
+    NSString *reason;
+    if (predicate) {
+        reason = [self mr_unsupportedReasonForPredicate:predicate attributeTypes:attributeTypes];
+    }
+    for (NSSortDescriptor *const sortDescriptor in sortDescriptors) {
+        if (reason) {
+            break;
+        }
+        if (sortDescriptor.selector == NULL) {
+            reason = [NSString stringWithFormat:@"sort descriptor %@ uses a comparator", sortDescriptor];
+        } else if (![self mr_isRecordedKeyPath:sortDescriptor.key attributeTypes:attributeTypes]) {
+            reason = [NSString stringWithFormat:@"sort key '%@' doesn't start with a recorded attribute", sortDescriptor.key];
+        }
+    }
+    if (reason == nil && sectionNameKeyPath && ![self mr_isRecordedKeyPath:sectionNameKeyPath attributeTypes:attributeTypes]) {
+        reason = [NSString stringWithFormat:@"section name key path '%@' doesn't start with a recorded attribute", sectionNameKeyPath];
+    }
+    if (reason) {
+        if (errorPtr) {
+            NSString *const description = [NSString stringWithFormat:@"Unsupported fetch request: %@.", reason];
+            *errorPtr = [self mr_errorWithCode:MRFetchedResultsChangesErrorUnsupportedFetchRequest description:description];
+        }
+        return NO;
+    }
+    return YES;
+}
+
++ (NSData *)mr_archivedDataWithRootObject:(id const)rootObject error:(NSError **const)errorPtr
+{
+    @try {
+        return [NSKeyedArchiver archivedDataWithRootObject:rootObject];
+    }
+    @catch (NSException *const exception) {
+        if (errorPtr) {
+            NSString *const description = [NSString stringWithFormat:@"Unsupported fetch request: %@.", exception.reason];
+            *errorPtr = [self mr_errorWithCode:MRFetchedResultsChangesErrorUnsupportedFetchRequest description:description];
+        }
+        return nil;
+    }
+}
+
++ (id)mr_unarchiveObjectOfClass:(Class const)aClass withData:(NSData *const)data error:(NSError **const)errorPtr
+{
+    id object;
+    @try {
+        object = ([data isKindOfClass:NSData.class] ? [NSKeyedUnarchiver unarchiveObjectWithData:data] : nil);
+    }
+    @catch (NSException *const exception) {
+        object = nil;
+    }
+    if (![object isKindOfClass:aClass]) {
+        if (errorPtr) {
+            NSString *const description = [NSString stringWithFormat:@"The trace doesn't contain a valid %@.", NSStringFromClass(aClass)];
+            *errorPtr = [self mr_errorWithCode:MRFetchedResultsChangesErrorInvalidTrace description:description];
+        }
+        return nil;
+    }
+    return object;
+}
+
+@end
+
+
+#pragma mark - MRFetchedResultsChangesReport -
+
+
+@interface MRFetchedResultsChangesReport ()
+@property (nonatomic, strong, readwrite) NSArray *latencies;
+@property (nonatomic, strong, readwrite) NSArray *intervals;
+@property (nonatomic, strong, readwrite) NSDictionary *callbackCounts;
+@property (nonatomic, strong, readwrite) NSString *checksum;
+@property (nonatomic, strong, readwrite) NSString *recordedChecksum;
+@end
+
+
+@implementation MRFetchedResultsChangesReport
+
+- (NSTimeInterval)totalLatency
+{
+    NSTimeInterval totalLatency = 0;
+    for (NSNumber *const latency in self.latencies) {
+        totalLatency += latency.doubleValue;
+    }
+    return totalLatency;
+}
+
+- (BOOL)matchesRecording
+{
+    NSString *const recordedChecksum = self.recordedChecksum;
+    return (recordedChecksum && [self.checksum isEqualToString:recordedChecksum]);
+}
+
+#pragma mark - NSObject
+
+- (NSString *)description
+{
+    NSArray *const latencies = self.latencies;
+    NSNumber *const maximumLatency = [latencies valueForKeyPath:@"@max.self"];
+    NSNumber *const recordedDuration = [self.intervals valueForKeyPath:@"@sum.self"];
+    return [NSString stringWithFormat:@"<%@: %p; entries = %lu; recordedDuration = %f; totalLatency = %f; maximumLatency = %f; callbackCounts = %@; checksum = %@; recordedChecksum = %@>"
+            , NSStringFromClass(self.class)
+            , self
+            , (unsigned long)latencies.count
+            , recordedDuration.doubleValue
+            , self.totalLatency
+            , maximumLatency.doubleValue
+            , self.callbackCounts
+            , self.checksum
+            , self.recordedChecksum];
+}
+
+@end
+
+
+#pragma mark - MRFetchedResultsChangesRecorder -
+
+
+@interface MRFetchedResultsChangesRecorder ()
+@property (nonatomic, strong, readwrite) MRFetchedResultsController *fetchedResultsController;
+@property (nonatomic, assign, readwrite, getter=isRecording) BOOL recording;
+@property (nonatomic, strong) id<NSObject> observer;
+@property (nonatomic, strong) NSString *notificationName;
+@property (nonatomic, assign) BOOL applyFetchedObjectsChanges;
+@property (nonatomic, strong) NSMutableDictionary *header;
+@property (nonatomic, strong) NSMutableArray *changes;
+@property (nonatomic, strong) NSDictionary *attributeTypes;
+@property (nonatomic, strong) NSMapTable *identifiers;
+@property (nonatomic, assign) CFAbsoluteTime lastTime;
+@end
+
+
+@implementation MRFetchedResultsChangesRecorder
+
+- (id)initWithFetchedResultsController:(MRFetchedResultsController *const)controller
+{
+    NSParameterAssert(controller);
+    if ((self = [self init])) {
+        _fetchedResultsController = controller;
+    }
+    return self;
+}
+
+- (BOOL)startRecording:(NSError **const)errorPtr
+{
+    MRFetchedResultsController *const controller = self.fetchedResultsController;
+    NSParameterAssert(controller.didPerformFetch);
+    [self mr_stopObserving];
+    self.header = nil;
+    self.changes = nil;
+    NSManagedObjectContext *const moc = controller.managedObjectContext;
+    NSFetchRequest *const fetchRequest = controller.fetchRequest;
+    NSString *const entityName = fetchRequest.entityName;
+    // collect recordable attributes
+    NSEntityDescription *const entity = [NSEntityDescription entityForName:entityName
+                                                    inManagedObjectContext:moc];
+    NSMutableDictionary *const attributeTypes = NSMutableDictionary.dictionary;
+    [entity.attributesByName enumerateKeysAndObjectsUsingBlock:
+     ^(NSString *const name, NSAttributeDescription *const attribute, BOOL *const stop) {
+         NSAttributeType const attributeType = attribute.attributeType;
+         if ([MRFetchedResultsChangesTrace mr_isSupportedAttributeType:attributeType]) {
+             attributeTypes[name] = @(attributeType);
+         }
+     }];
+    // check that the fetch request can be replayed
+    NSPredicate *const predicate = fetchRequest.predicate;
+    NSArray *const sortDescriptors = fetchRequest.sortDescriptors;
+    NSString *const sectionNameKeyPath = controller.sectionNameKeyPath;
+    BOOL const isSupported = [MRFetchedResultsChangesTrace mr_validatePredicate:predicate
+                                                                sortDescriptors:sortDescriptors
+                                                             sectionNameKeyPath:sectionNameKeyPath
+                                                                 attributeTypes:attributeTypes
+                                                                          error:errorPtr];
+    if (!isSupported) {
+        return NO;
+    }
+    NSData *predicateData;
+    if (predicate) {
+        predicateData = [MRFetchedResultsChangesTrace mr_archivedDataWithRootObject:predicate error:errorPtr];
+        if (predicateData == nil) {
+            return NO;
+        }
+    }
+    NSData *const sortDescriptorsData = [MRFetchedResultsChangesTrace mr_archivedDataWithRootObject:sortDescriptors
+                                                                                              error:errorPtr];
+    if (sortDescriptorsData == nil) {
+        return NO;
+    }
+    // changes queued before recording can't be replayed
+    if (controller.insertedObjects.count > 0
+        || controller.updatedObjects.count > 0
+        || controller.deletedObjects.count > 0) {
+        if (errorPtr) {
+            NSString *const description = @"The controller has queued changes. Set applyFetchedObjectsChanges before recording.";
+            *errorPtr = [MRFetchedResultsChangesTrace mr_errorWithCode:MRFetchedResultsChangesErrorQueuedChanges
+                                                           description:description];
+        }
+        return NO;
+    }
+    // take snapshot of every object of the entity, not only the fetched ones
+    NSFetchRequest *const snapshotRequest = [NSFetchRequest fetchRequestWithEntityName:entityName];
+    NSArray *const objects = [moc executeFetchRequest:snapshotRequest error:errorPtr];
+    if (objects == nil) {
+        return NO;
+    }
+    self.attributeTypes = attributeTypes;
+    self.identifiers = NSMapTable.weakToStrongObjectsMapTable;
+    NSMutableArray *const snapshot = [NSMutableArray arrayWithCapacity:objects.count];
+    for (NSManagedObject *const object in objects) {
+        [snapshot addObject:@{ MRTraceIdentifierKey: [self mr_identifierForObject:object],
+                               MRTracePendingKey: @(object.isInserted),
+                               MRTraceValuesKey: [self mr_valuesOfObject:object] }];
+    }
+    // collect delegate methods
+    NSMutableArray *const delegateSelectors = NSMutableArray.array;
+    if (controller.notifyDidChangeObject) {
+        [delegateSelectors addObject:NSStringFromSelector(@selector(controller:didChangeObject:atIndexPath:forChangeType:newIndexPath:))];
+    }
+    if (controller.notifyDidChangeSection) {
+        [delegateSelectors addObject:NSStringFromSelector(@selector(controller:didChangeSection:atIndex:forChangeType:))];
+    }
+    if (controller.notifyWillChangeContent) {
+        [delegateSelectors addObject:NSStringFromSelector(@selector(controllerWillChangeContent:))];
+    }
+    if (controller.notifyDidChangeContent) {
+        [delegateSelectors addObject:NSStringFromSelector(@selector(controllerDidChangeContent:))];
+    }
+    if (controller.notifyDidChangeSectionsAndObjects) {
+        [delegateSelectors addObject:NSStringFromSelector(@selector(controller:didChangeSections:andObjects:))];
+    }
+    if (controller.notifySectionIndexTitle) {
+        [delegateSelectors addObject:NSStringFromSelector(@selector(controller:sectionIndexTitleForSectionName:))];
+    }
+    // build header
+    BOOL const applyFetchedObjectsChanges = controller.applyFetchedObjectsChanges;
+    NSMutableDictionary *const header = NSMutableDictionary.dictionary;
+    header[MRTraceVersionKey] = @(MRTraceVersion);
+    header[MRTraceEntityNameKey] = entityName;
+    header[MRTraceAttributesKey] = attributeTypes.copy;
+    if (predicateData) {
+        header[MRTracePredicateKey] = predicateData;
+    }
+    header[MRTraceSortDescriptorsKey] = sortDescriptorsData;
+    if (sectionNameKeyPath) {
+        header[MRTraceSectionNameKeyPathKey] = sectionNameKeyPath;
+    }
+    header[MRTraceChangesAppliedOnSaveKey] = @(controller.changesAppliedOnSave);
+    header[MRTraceApplyFetchedObjectsChangesKey] = @(applyFetchedObjectsChanges);
+    header[MRTraceDelegateSelectorsKey] = delegateSelectors;
+    header[MRTraceSnapshotKey] = snapshot;
+    self.header = header;
+    self.changes = NSMutableArray.array;
+    self.applyFetchedObjectsChanges = applyFetchedObjectsChanges;
+    // start observing
+    self.lastTime = CFAbsoluteTimeGetCurrent();
+    __weak typeof(self) const welf = self;
+    NSString *const name = controller.mr_managedObjectContextNotificationName;
+    self.notificationName = name;
+    self.observer =
+    [NSNotificationCenter.defaultCenter addObserverForName:name
+                                                    object:moc
+                                                     queue:nil
+                                                usingBlock:^(NSNotification *const note) {
+                                                    NSDictionary *const userInfo = note.userInfo;
+                                                    [welf mr_recordContent:userInfo];
+                                                }];
+    NSKeyValueObservingOptions const options = NSKeyValueObservingOptionNew;
+    [controller addObserver:self
+                 forKeyPath:MRTraceApplyFetchedObjectsChangesKey
+                    options:options
+                    context:MRFetchedResultsChangesRecorderContext];
+    [controller addObserver:self
+                 forKeyPath:MRTraceChangesAppliedOnSaveKey
+                    options:options
+                    context:MRFetchedResultsChangesRecorderContext];
+    [controller addObserver:self
+                 forKeyPath:NSStringFromSelector(@selector(didPerformFetch))
+                    options:options
+                    context:MRFetchedResultsChangesRecorderContext];
+    self.recording = YES;
+    return YES;
+}
+
+- (void)stopRecording
+{
+    if ([self mr_stopObserving]) {
+        MRFetchedResultsController *const controller = self.fetchedResultsController;
+        self.header[MRTraceChecksumKey] =
+        [MRFetchedResultsChangesTrace mr_checksumForSections:controller.sections
+                                              attributeTypes:self.attributeTypes
+                                                 identifiers:self.identifiers];
+    }
+}
+
+- (NSDictionary *)trace
+{
+    NSMutableDictionary *const header = self.header;
+    if (header == nil) {
+        return nil;
+    }
+    NSMutableDictionary *const trace = header.mutableCopy;
+    trace[MRTraceChangesKey] = self.changes.copy;
+    return trace;
+}
+
+- (BOOL)writeToURL:(NSURL *const)url error:(NSError **const)errorPtr
+{
+    NSParameterAssert(url);
+    NSDictionary *const trace = self.trace;
+    NSParameterAssert(trace);
+    NSData *const data = [NSPropertyListSerialization dataWithPropertyList:trace
+                                                                    format:NSPropertyListBinaryFormat_v1_0
+                                                                   options:0
+                                                                     error:errorPtr];
+    return [data writeToURL:url options:NSDataWritingAtomic error:errorPtr];
+}
+
+#pragma mark Private
+
+- (NSString *)mr_identifierForObject:(NSManagedObject *const)object
+{
+    // objects keep the identifier they had when first seen, so that temporary IDs remain valid after saving
+    NSMapTable *const identifiers = self.identifiers;
+    NSString *identifier = [identifiers objectForKey:object];
+    if (identifier == nil) {
+        identifier = object.objectID.URIRepresentation.absoluteString;
+        [identifiers setObject:identifier forKey:object];
+    }
+    return identifier;
+}
+
+- (NSDictionary *)mr_valuesOfObject:(NSManagedObject *const)object
+{
+    NSMutableDictionary *const values = NSMutableDictionary.dictionary;
+    [self.attributeTypes enumerateKeysAndObjectsUsingBlock:
+     ^(NSString *const key, NSNumber *const attributeType, BOOL *const stop) {
+         id value = [object valueForKey:key];
+         if (attributeType.unsignedIntegerValue == NSDecimalAttributeType) {
+             value = [value description];
+         }
+         if (value) {
+             values[key] = value;
+         }
+     }];
+    return values;
+}
+
+- (NSArray *)mr_changedKeysOfObject:(NSManagedObject *const)object
+{
+    NSDictionary *const attributeTypes = self.attributeTypes;
+    NSMutableArray *const keys = NSMutableArray.array;
+    if ([object respondsToSelector:@selector(changedValuesForCurrentEvent)]) {
+        for (NSString *const key in object.changedValuesForCurrentEvent) {
+            if (attributeTypes[key]) {
+                [keys addObject:key];
+            }
+        }
+    }
+    // saved objects and relationship-only changes don't tell which attributes changed
+    return (keys.count > 0 ? keys : attributeTypes.allKeys);
+}
+
+- (void)mr_recordEntry:(NSDictionary *const)entry
+{
+    CFAbsoluteTime const time = CFAbsoluteTimeGetCurrent();
+    NSMutableDictionary *const timedEntry = entry.mutableCopy;
+    timedEntry[MRTraceTimeKey] = @(time - self.lastTime);
+    [self.changes addObject:timedEntry];
+    self.lastTime = time;
+}
+
+- (void)mr_recordContent:(NSDictionary *const)userInfo
+{
+    MRFetchedResultsController *const controller = self.fetchedResultsController;
+    NSPredicate *const entityPredicate = [controller mr_buildEntityPredicateForFetchRequest:controller.fetchRequest];
+    NSSet *const deletedObjects = [userInfo[NSDeletedObjectsKey] filteredSetUsingPredicate:entityPredicate];
+    NSSet *const insertedObjects = [userInfo[NSInsertedObjectsKey] filteredSetUsingPredicate:entityPredicate];
+    NSSet *const updatedObjects = [userInfo[NSUpdatedObjectsKey] filteredSetUsingPredicate:entityPredicate];
+    if (deletedObjects.count == 0 && insertedObjects.count == 0 && updatedObjects.count == 0) {
+        return;
+    }
+    NSMutableArray *const deleted = [NSMutableArray arrayWithCapacity:deletedObjects.count];
+    for (NSManagedObject *const object in deletedObjects) {
+        [deleted addObject:@{ MRTraceIdentifierKey: [self mr_identifierForObject:object] }];
+    }
+    NSMutableArray *const inserted = [NSMutableArray arrayWithCapacity:insertedObjects.count];
+    for (NSManagedObject *const object in insertedObjects) {
+        [inserted addObject:@{ MRTraceIdentifierKey: [self mr_identifierForObject:object],
+                               MRTraceValuesKey: [self mr_valuesOfObject:object] }];
+    }
+    NSMutableArray *const updated = [NSMutableArray arrayWithCapacity:updatedObjects.count];
+    for (NSManagedObject *const object in updatedObjects) {
+        [updated addObject:@{ MRTraceIdentifierKey: [self mr_identifierForObject:object],
+                              MRTraceKeysKey: [self mr_changedKeysOfObject:object],
+                              MRTraceValuesKey: [self mr_valuesOfObject:object] }];
+    }
+    [self mr_recordEntry:@{ MRTraceDeletedKey: deleted,
+                            MRTraceInsertedKey: inserted,
+                            MRTraceUpdatedKey: updated }];
+}
+
+- (BOOL)mr_stopObserving
+{
+    id<NSObject> const observer = self.observer;
+    if (observer) {
+        self.observer = nil;
+        self.recording = NO;
+        MRFetchedResultsController *const controller = self.fetchedResultsController;
+        [NSNotificationCenter.defaultCenter removeObserver:observer
+                                                      name:self.notificationName
+                                                    object:controller.managedObjectContext];
+        [controller removeObserver:self
+                        forKeyPath:MRTraceApplyFetchedObjectsChangesKey
+                           context:MRFetchedResultsChangesRecorderContext];
+        [controller removeObserver:self
+                        forKeyPath:MRTraceChangesAppliedOnSaveKey
+                           context:MRFetchedResultsChangesRecorderContext];
+        [controller removeObserver:self
+                        forKeyPath:NSStringFromSelector(@selector(didPerformFetch))
+                           context:MRFetchedResultsChangesRecorderContext];
+        return YES;
+    }
+    return NO;
+}
+
+#pragma mark - NSKeyValueObserving
+
+- (void)observeValueForKeyPath:(NSString *const)keyPath
+                      ofObject:(id const)object
+                        change:(NSDictionary *const)change
+                       context:(void *const)context
+{
+    if (context != MRFetchedResultsChangesRecorderContext) {
+        [super observeValueForKeyPath:keyPath ofObject:object change:change context:context];
+        return;
+    }
+    BOOL const value = [change[NSKeyValueChangeNewKey] boolValue];
+    if ([keyPath isEqualToString:MRTraceApplyFetchedObjectsChangesKey]) {
+        if (value != self.applyFetchedObjectsChanges) {
+            self.applyFetchedObjectsChanges = value;
+            [self mr_recordEntry:@{ MRTraceApplyFetchedObjectsChangesKey: @(value) }];
+        }
+    } else if ([keyPath isEqualToString:MRTraceChangesAppliedOnSaveKey]) {
+        if (value != [self.header[MRTraceChangesAppliedOnSaveKey] boolValue]) {
+            NSLog(@"CoreData: error: (MRFetchedResultsChangesRecorder) "
+                  @"changesAppliedOnSave of %@ changed while recording. "
+                  @"Recording will be stopped"
+                  , object);
+            [self stopRecording];
+        }
+    } else if ([keyPath isEqualToString:NSStringFromSelector(@selector(didPerformFetch))]) {
+        NSLog(@"CoreData: error: (MRFetchedResultsChangesRecorder) "
+              @"%@ performed a fetch while recording. "
+              @"Recording will be stopped without a checksum"
+              , object);
+        // the sections already hold the results of the new fetch, which can't be replayed
+        [self mr_stopObserving];
+    }
+}
+
+#pragma mark - NSObject
+
+- (void)dealloc
+{
+    [self mr_stopObserving];
+}
+
+@end
+
+
+
+#pragma mark - MRFetchedResultsChangesCounter -
+
+
+/**
+ Delegate used during replays that counts its invocations and only responds to the delegate methods implemented by the recorded delegate.
+ */
+@interface MRFetchedResultsChangesCounter : NSObject <MRFetchedResultsControllerDelegate>
+@property (nonatomic, strong) NSSet *selectorNames;
+@property (nonatomic, strong) NSMutableDictionary *counts;
+@end
+
+
+@implementation MRFetchedResultsChangesCounter
+
++ (NSSet *)delegateSelectorNames
+{
+    return [NSSet setWithObjects:
+            NSStringFromSelector(@selector(controller:didChangeObject:atIndexPath:forChangeType:newIndexPath:)),
+            NSStringFromSelector(@selector(controller:didChangeSection:atIndex:forChangeType:)),
+            NSStringFromSelector(@selector(controllerWillChangeContent:)),
+            NSStringFromSelector(@selector(controllerDidChangeContent:)),
+            NSStringFromSelector(@selector(controller:didChangeSections:andObjects:)),
+            NSStringFromSelector(@selector(controller:sectionIndexTitleForSectionName:)),
+            nil];
+}
+
+- (instancetype)initWithSelectorNames:(NSArray *const)selectorNames
+{
+    self = [self init];
+    if (self) {
+        _selectorNames = [NSSet setWithArray:selectorNames];
+        _counts = NSMutableDictionary.dictionary;
+    }
+    return self;
+}
+
+- (void)mr_count:(SEL const)selector
+{
+    NSString *const name = NSStringFromSelector(selector);
+    NSMutableDictionary *const counts = self.counts;
+    counts[name] = @([counts[name] unsignedIntegerValue] + 1);
+}
+
+- (void)controller:(MRFetchedResultsController *)controller didChangeObject:(id)anObject atIndexPath:(NSIndexPath *)indexPath forChangeType:(MRFetchedResultsChangeType)type newIndexPath:(NSIndexPath *)newIndexPath
+{
+    [self mr_count:_cmd];
+}
+
+- (void)controller:(MRFetchedResultsController *)controller didChangeSection:(id<MRFetchedResultsSectionInfo>)sectionInfo atIndex:(NSUInteger)sectionIndex forChangeType:(MRFetchedResultsChangeType)type
+{
+    [self mr_count:_cmd];
+}
+
+- (void)controllerWillChangeContent:(MRFetchedResultsController *)controller
+{
+    [self mr_count:_cmd];
+}
+
+- (void)controller:(MRFetchedResultsController *)controller didChangeSections:(NSArray *)sectionChanges andObjects:(NSArray *)objectChanges
+{
+    [self mr_count:_cmd];
+}
+
+- (void)controllerDidChangeContent:(MRFetchedResultsController *)controller
+{
+    [self mr_count:_cmd];
+}
+
+- (NSString *)controller:(MRFetchedResultsController *)controller sectionIndexTitleForSectionName:(NSString *)sectionName
+{
+    [self mr_count:_cmd];
+    return [controller sectionIndexTitleForSectionName:sectionName];
+}
+
+#pragma mark - NSObject
+
+- (BOOL)respondsToSelector:(SEL const)aSelector
+{
+    NSString *const name = NSStringFromSelector(aSelector);
+    if ([self.class.delegateSelectorNames containsObject:name]) {
+        return [self.selectorNames containsObject:name];
+    }
+    return [super respondsToSelector:aSelector];
+}
+
+@end
+
+
+#pragma mark - MRFetchedResultsChangesPlayer -
+
+
+@interface MRFetchedResultsChangesPlayer ()
+@property (nonatomic, strong, readwrite) NSDictionary *trace;
+@property (nonatomic, strong) NSDictionary *attributeTypes;
+@property (nonatomic, strong) NSManagedObjectContext *managedObjectContext;
+@property (nonatomic, strong) NSMutableDictionary *objectsByIdentifier;
+@property (nonatomic, strong) NSMapTable *identifiers;
+@property (nonatomic, strong) id<NSObject> observer;
+@property (nonatomic, assign) NSTimeInterval latency;
+@end
+
+
+@implementation MRFetchedResultsChangesPlayer
+
++ (instancetype)playerWithContentsOfURL:(NSURL *const)url error:(NSError **const)errorPtr
+{
+    NSParameterAssert(url);
+    NSData *const data = [NSData dataWithContentsOfURL:url options:0 error:errorPtr];
+    if (data == nil) {
+        return nil;
+    }
+    id const trace = [NSPropertyListSerialization propertyListWithData:data
+                                                               options:NSPropertyListImmutable
+                                                                format:NULL
+                                                                 error:errorPtr];
+    if (trace == nil) {
+        return nil;
+    }
+    if (![MRFetchedResultsChangesTrace mr_validateTrace:trace error:errorPtr]) {
+        return nil;
+    }
+    return [[self alloc] initWithTrace:trace];
+}
+
+- (id)initWithTrace:(NSDictionary *const)trace
+{
+    NSParameterAssert([MRFetchedResultsChangesTrace mr_validateTrace:trace error:NULL]);
+    if ((self = [self init])) {
+        _trace = trace;
+    }
+    return self;
+}
+
+- (MRFetchedResultsChangesReport *)replay:(NSError **const)errorPtr
+{
+    NSDictionary *const trace = self.trace;
+    if (![MRFetchedResultsChangesTrace mr_validateTrace:trace error:errorPtr]) {
+        return nil;
+    }
+    self.attributeTypes = trace[MRTraceAttributesKey];
+    self.objectsByIdentifier = NSMutableDictionary.dictionary;
+    self.identifiers = NSMapTable.strongToStrongObjectsMapTable;
+    // rebuild fetch request
+    NSData *const predicateData = trace[MRTracePredicateKey];
+    NSPredicate *predicate;
+    if (predicateData) {
+        predicate = [MRFetchedResultsChangesTrace mr_unarchiveObjectOfClass:NSPredicate.class
+                                                                   withData:predicateData
+                                                                      error:errorPtr];
+        if (predicate == nil) {
+            return nil;
+        }
+    }
+    NSArray *const sortDescriptors =
+    [MRFetchedResultsChangesTrace mr_unarchiveObjectOfClass:NSArray.class
+                                                   withData:trace[MRTraceSortDescriptorsKey]
+                                                      error:errorPtr];
+    if (sortDescriptors == nil) {
+        return nil;
+    }
+    NSString *const sectionNameKeyPath = trace[MRTraceSectionNameKeyPathKey];
+    BOOL const isSupported = [MRFetchedResultsChangesTrace mr_validatePredicate:predicate
+                                                                sortDescriptors:sortDescriptors
+                                                             sectionNameKeyPath:sectionNameKeyPath
+                                                                 attributeTypes:self.attributeTypes
+                                                                          error:errorPtr];
+    if (!isSupported) {
+        return nil;
+    }
+    NSString *const entityName = trace[MRTraceEntityNameKey];
+    NSFetchRequest *const fetchRequest = [NSFetchRequest fetchRequestWithEntityName:entityName];
+    fetchRequest.predicate = predicate;
+    fetchRequest.sortDescriptors = sortDescriptors;
+    // rebuild store
+    NSManagedObjectContext *const moc = [self mr_buildManagedObjectContext:errorPtr];
+    if (moc == nil) {
+        return nil;
+    }
+    self.managedObjectContext = moc;
+    if (![self mr_insertSnapshot:trace[MRTraceSnapshotKey] error:errorPtr]) {
+        return nil;
+    }
+    // rebuild controller
+    MRFetchedResultsController *const controller =
+    [[MRFetchedResultsController alloc] initWithFetchRequest:fetchRequest
+                                        managedObjectContext:moc
+                                          sectionNameKeyPath:sectionNameKeyPath
+                                                   cacheName:nil];
+    BOOL const changesAppliedOnSave = [trace[MRTraceChangesAppliedOnSaveKey] boolValue];
+    controller.changesAppliedOnSave = changesAppliedOnSave;
+    controller.applyFetchedObjectsChanges = [trace[MRTraceApplyFetchedObjectsChangesKey] boolValue];
+    MRFetchedResultsChangesCounter *const counter =
+    [[MRFetchedResultsChangesCounter alloc] initWithSelectorNames:trace[MRTraceDelegateSelectorsKey]];
+    controller.delegate = counter;
+    if (![controller performFetch:errorPtr]) {
+        return nil;
+    }
+    [counter.counts removeAllObjects];
+    // replace the controller's observer with one that measures it
+    [controller mr_stopMonitoringChanges];
+    __weak typeof(self) const welf = self;
+    __weak MRFetchedResultsController *const weakController = controller;
+    NSString *const name = controller.mr_managedObjectContextNotificationName;
+    self.observer =
+    [NSNotificationCenter.defaultCenter addObserverForName:name
+                                                    object:moc
+                                                     queue:nil
+                                                usingBlock:^(NSNotification *const note) {
+                                                    NSDictionary *const userInfo = note.userInfo;
+                                                    CFAbsoluteTime const start = CFAbsoluteTimeGetCurrent();
+                                                    [weakController mr_updateContent:userInfo];
+                                                    welf.latency += CFAbsoluteTimeGetCurrent() - start;
+                                                }];
+    // replay changes
+    NSArray *const changes = trace[MRTraceChangesKey];
+    NSMutableArray *const latencies = [NSMutableArray arrayWithCapacity:changes.count];
+    NSMutableArray *const intervals = [NSMutableArray arrayWithCapacity:changes.count];
+    BOOL success = YES;
+    for (NSDictionary *const change in changes) {
+        [intervals addObject:(change[MRTraceTimeKey] ?: @0)];
+        NSNumber *const applyFetchedObjectsChanges = change[MRTraceApplyFetchedObjectsChangesKey];
+        if (applyFetchedObjectsChanges) {
+            CFAbsoluteTime const start = CFAbsoluteTimeGetCurrent();
+            controller.applyFetchedObjectsChanges = applyFetchedObjectsChanges.boolValue;
+            [latencies addObject:@(CFAbsoluteTimeGetCurrent() - start)];
+            continue;
+        }
+        success = [self mr_prepareChange:change error:errorPtr];
+        if (!success) {
+            break;
+        }
+        self.latency = 0;
+        [self mr_applyChange:change];
+        if (changesAppliedOnSave) {
+            success = [moc save:errorPtr];
+        } else {
+            [moc processPendingChanges];
+        }
+        if (!success) {
+            break;
+        }
+        [latencies addObject:@(self.latency)];
+    }
+    [self mr_stopObservingContext:moc name:name];
+    if (!success) {
+        return nil;
+    }
+    // build report
+    MRFetchedResultsChangesReport *const report = [[MRFetchedResultsChangesReport alloc] init];
+    report.latencies = latencies;
+    report.intervals = intervals;
+    report.callbackCounts = counter.counts.copy;
+    report.checksum = [MRFetchedResultsChangesTrace mr_checksumForSections:controller.sections
+                                                            attributeTypes:self.attributeTypes
+                                                               identifiers:self.identifiers];
+    report.recordedChecksum = trace[MRTraceChecksumKey];
+    controller.delegate = nil;
+    return report;
+}
+
+#pragma mark Private
+
+- (NSManagedObjectContext *)mr_buildManagedObjectContext:(NSError **const)errorPtr
+{
+    NSDictionary *const trace = self.trace;
+    NSEntityDescription *const entity = [[NSEntityDescription alloc] init];
+    entity.name = trace[MRTraceEntityNameKey];
+    entity.managedObjectClassName = NSStringFromClass(NSManagedObject.class);
+    NSMutableArray *const properties = NSMutableArray.array;
+    [self.attributeTypes enumerateKeysAndObjectsUsingBlock:
+     ^(NSString *const name, NSNumber *const attributeType, BOOL *const stop) {
+         NSAttributeDescription *const attribute = [[NSAttributeDescription alloc] init];
+         attribute.name = name;
+         attribute.attributeType = attributeType.unsignedIntegerValue;
+         // relationships are not recorded, so validation rules can't be honoured
+         attribute.optional = YES;
+         [properties addObject:attribute];
+     }];
+    entity.properties = properties;
+    NSManagedObjectModel *const model = [[NSManagedObjectModel alloc] init];
+    model.entities = @[ entity ];
+    NSPersistentStoreCoordinator *const coordinator =
+    [[NSPersistentStoreCoordinator alloc] initWithManagedObjectModel:model];
+    NSPersistentStore *const store = [coordinator addPersistentStoreWithType:NSInMemoryStoreType
+                                                               configuration:nil
+                                                                         URL:nil
+                                                                     options:nil
+                                                                       error:errorPtr];
+    if (store == nil) {
+        return nil;
+    }
+    NSManagedObjectContext *const moc = [[NSManagedObjectContext alloc] init];
+    moc.persistentStoreCoordinator = coordinator;
+    return moc;
+}
+
+- (BOOL)mr_insertSnapshot:(NSArray *const)snapshot error:(NSError **const)errorPtr
+{
+    // objects that were pending insertions are left unsaved; those whose insertion was notified during the recording are also left unprocessed, so that it is replayed as an insertion
+    NSMutableSet *const notifiedIdentifiers = NSMutableSet.set;
+    for (NSDictionary *const change in self.trace[MRTraceChangesKey]) {
+        for (NSDictionary *const record in change[MRTraceInsertedKey]) {
+            [notifiedIdentifiers addObject:record[MRTraceIdentifierKey]];
+        }
+    }
+    NSMutableArray *const processedRecords = NSMutableArray.array;
+    NSMutableArray *const unprocessedRecords = NSMutableArray.array;
+    for (NSDictionary *const record in snapshot) {
+        if (![record[MRTracePendingKey] boolValue]) {
+            [self mr_insertObjectWithRecord:record];
+        } else if ([notifiedIdentifiers containsObject:record[MRTraceIdentifierKey]]) {
+            [unprocessedRecords addObject:record];
+        } else {
+            [processedRecords addObject:record];
+        }
+    }
+    NSManagedObjectContext *const moc = self.managedObjectContext;
+    if (![moc save:errorPtr]) {
+        return NO;
+    }
+    for (NSDictionary *const record in processedRecords) {
+        [self mr_insertObjectWithRecord:record];
+    }
+    [moc processPendingChanges];
+    for (NSDictionary *const record in unprocessedRecords) {
+        [self mr_insertObjectWithRecord:record];
+    }
+    return YES;
+}
+
+- (NSManagedObject *)mr_insertObjectWithRecord:(NSDictionary *const)record
+{
+    NSDictionary *const values = record[MRTraceValuesKey];
+    NSManagedObject *const object = [self mr_insertObjectWithValues:values
+                                                            forKeys:values.allKeys
+                                             inManagedObjectContext:self.managedObjectContext];
+    [self mr_registerObject:object withIdentifier:record[MRTraceIdentifierKey]];
+    return object;
+}
+
+- (NSManagedObject *)mr_insertObjectWithValues:(NSDictionary *const)values
+                                       forKeys:(NSArray *const)keys
+                        inManagedObjectContext:(NSManagedObjectContext *const)moc
+{
+    NSString *const entityName = self.trace[MRTraceEntityNameKey];
+    NSManagedObject *const object = [NSEntityDescription insertNewObjectForEntityForName:entityName
+                                                                  inManagedObjectContext:moc];
+    [self mr_setValues:values forKeys:keys ofObject:object];
+    return object;
+}
+
+- (void)mr_registerObject:(NSManagedObject *const)object withIdentifier:(NSString *const)identifier
+{
+    self.objectsByIdentifier[identifier] = object;
+    [self.identifiers setObject:identifier forKey:object];
+}
+
+- (void)mr_setValues:(NSDictionary *const)values
+             forKeys:(NSArray *const)keys
+            ofObject:(NSManagedObject *const)object
+{
+    NSDictionary *const attributeTypes = self.attributeTypes;
+    for (NSString *const key in keys) {
+        NSNumber *const attributeType = attributeTypes[key];
+        if (attributeType == nil) {
+            continue;
+        }
+        id value = values[key];
+        if (value && attributeType.unsignedIntegerValue == NSDecimalAttributeType) {
+            value = [NSDecimalNumber decimalNumberWithString:value];
+        }
+        [object setValue:value forKey:key];
+    }
+}
+
+- (BOOL)mr_prepareChange:(NSDictionary *const)change error:(NSError **const)errorPtr
+{
+    // objects updated before being seen by the recorder are saved from another context, so that the controller is not notified and the pending insertions of the snapshot remain pending
+    NSMutableArray *const missingRecords = NSMutableArray.array;
+    NSDictionary *const objectsByIdentifier = self.objectsByIdentifier;
+    for (NSDictionary *const record in change[MRTraceUpdatedKey]) {
+        if (objectsByIdentifier[record[MRTraceIdentifierKey]] == nil) {
+            [missingRecords addObject:record];
+        }
+    }
+    if (missingRecords.count == 0) {
+        return YES;
+    }
+    NSManagedObjectContext *const moc = self.managedObjectContext;
+    NSManagedObjectContext *const missingObjectsContext = [[NSManagedObjectContext alloc] init];
+    missingObjectsContext.persistentStoreCoordinator = moc.persistentStoreCoordinator;
+    NSMutableArray *const missingObjects = [NSMutableArray arrayWithCapacity:missingRecords.count];
+    for (NSDictionary *const record in missingRecords) {
+        // changed keys are left unset, so that applying the change updates them
+        NSDictionary *const values = record[MRTraceValuesKey];
+        NSMutableArray *const keys = values.allKeys.mutableCopy;
+        [keys removeObjectsInArray:record[MRTraceKeysKey]];
+        NSManagedObject *const object = [self mr_insertObjectWithValues:values
+                                                                forKeys:keys
+                                                 inManagedObjectContext:missingObjectsContext];
+        [missingObjects addObject:object];
+    }
+    if (![missingObjectsContext save:errorPtr]) {
+        return NO;
+    }
+    [missingRecords enumerateObjectsUsingBlock:^(NSDictionary *const record, NSUInteger const idx, BOOL *const stop) {
+        NSManagedObjectID *const objectID = [missingObjects[idx] objectID];
+        [self mr_registerObject:[moc objectWithID:objectID] withIdentifier:record[MRTraceIdentifierKey]];
+    }];
+    return YES;
+}
+
+- (void)mr_applyChange:(NSDictionary *const)change
+{
+    NSManagedObjectContext *const moc = self.managedObjectContext;
+    NSMutableDictionary *const objectsByIdentifier = self.objectsByIdentifier;
+    for (NSDictionary *const record in change[MRTraceDeletedKey]) {
+        NSString *const identifier = record[MRTraceIdentifierKey];
+        NSManagedObject *const object = objectsByIdentifier[identifier];
+        if (object) {
+            [moc deleteObject:object];
+            [objectsByIdentifier removeObjectForKey:identifier];
+        }
+    }
+    for (NSDictionary *const record in change[MRTraceInsertedKey]) {
+        NSManagedObject *const object = objectsByIdentifier[record[MRTraceIdentifierKey]];
+        if (object) {
+            // pending insertions of the snapshot are still pending, so they are notified as insertions
+            NSDictionary *const values = record[MRTraceValuesKey];
+            [self mr_setValues:values forKeys:self.attributeTypes.allKeys ofObject:object];
+        } else {
+            [self mr_insertObjectWithRecord:record];
+        }
+    }
+    for (NSDictionary *const record in change[MRTraceUpdatedKey]) {
+        NSManagedObject *const object = objectsByIdentifier[record[MRTraceIdentifierKey]];
+        [self mr_setValues:record[MRTraceValuesKey] forKeys:record[MRTraceKeysKey] ofObject:object];
+    }
+}
+
+- (void)mr_stopObservingContext:(NSManagedObjectContext *const)moc name:(NSString *const)name
+{
+    id<NSObject> const observer = self.observer;
+    if (observer) {
+        self.observer = nil;
+        [NSNotificationCenter.defaultCenter removeObserver:observer
+                                                      name:name
+                                                    object:moc];
+    }
+}
+
+@end